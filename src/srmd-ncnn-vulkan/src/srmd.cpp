@@ -3,18 +3,61 @@
 #include "srmd.h"
 
 #include <algorithm>
+#include <string.h>
 #include <vector>
 
 #include "srmd_preproc.comp.hex.h"
 #include "srmd_postproc.comp.hex.h"
 #include "srmd_preproc_tta.comp.hex.h"
 #include "srmd_postproc_tta.comp.hex.h"
+#include "srmd_yuv2rgb.comp.hex.h"
+#include "srmd_rgb2yuv.comp.hex.h"
+
+// copy rows [y0, y1) of a w x h yuv 4:2:0 frame into a w x (y1 - y0) frame of the same format, y0 and y1 even
+static void yuv_band_from_frame(const unsigned char *frame, int w, int h, int y0, int y1, int format,
+                                unsigned char *band) {
+    const int band_h = y1 - y0;
+
+    memcpy(band, frame + y0 * w, w * band_h);
+
+    const unsigned char *frame_chroma = frame + w * h;
+    unsigned char *band_chroma = band + w * band_h;
+
+    if (format == SRMD_FORMAT_NV12) {
+        memcpy(band_chroma, frame_chroma + y0 / 2 * w, w * band_h / 2);
+    } else {
+        const int cw = w / 2;
+        memcpy(band_chroma, frame_chroma + y0 / 2 * cw, cw * band_h / 2);
+        memcpy(band_chroma + cw * band_h / 2, frame_chroma + cw * h / 2 + y0 / 2 * cw, cw * band_h / 2);
+    }
+}
+
+// inverse of yuv_band_from_frame
+static void yuv_band_to_frame(const unsigned char *band, int w, int h, int y0, int y1, int format,
+                              unsigned char *frame) {
+    const int band_h = y1 - y0;
+
+    memcpy(frame + y0 * w, band, w * band_h);
+
+    unsigned char *frame_chroma = frame + w * h;
+    const unsigned char *band_chroma = band + w * band_h;
+
+    if (format == SRMD_FORMAT_NV12) {
+        memcpy(frame_chroma + y0 / 2 * w, band_chroma, w * band_h / 2);
+    } else {
+        const int cw = w / 2;
+        memcpy(frame_chroma + y0 / 2 * cw, band_chroma, cw * band_h / 2);
+        memcpy(frame_chroma + cw * h / 2 + y0 / 2 * cw, band_chroma + cw * band_h / 2, cw * band_h / 2);
+    }
+}
 
 SRMD::SRMD(int gpuid, bool _tta_mode) {
     vkdev = gpuid == -1 ? 0 : ncnn::get_gpu_device(gpuid);
 
     srmd_preproc = 0;
     srmd_postproc = 0;
+    srmd_yuv2rgb = 0;
+    srmd_rgb2yuv = 0;
     bicubic_2x = 0;
     bicubic_3x = 0;
     bicubic_4x = 0;
@@ -27,6 +70,8 @@ SRMD::~SRMD() {
     {
         delete srmd_preproc;
         delete srmd_postproc;
+        delete srmd_yuv2rgb;
+        delete srmd_rgb2yuv;
     }
 
     bicubic_2x->destroy_pipeline(net.opt);
@@ -123,6 +168,37 @@ int SRMD::load(const std::string &parampath, const std::string &modelpath)
             srmd_postproc->set_optimal_local_size_xyz(8, 8, 3);
             srmd_postproc->create(spirv.data(), spirv.size() * 4, specializations);
         }
+
+        // yuv <-> rgb, shared by the tta and non-tta paths
+        {
+            static std::vector <uint32_t> spirv;
+            static ncnn::Mutex lock;
+            {
+                ncnn::MutexLockGuard guard(lock);
+                if (spirv.empty()) {
+                    compile_spirv_module(srmd_yuv2rgb_comp_data, sizeof(srmd_yuv2rgb_comp_data), net.opt, spirv);
+                }
+            }
+
+            srmd_yuv2rgb = new ncnn::Pipeline(vkdev);
+            srmd_yuv2rgb->set_optimal_local_size_xyz(8, 8, 1);
+            srmd_yuv2rgb->create(spirv.data(), spirv.size() * 4, specializations);
+        }
+
+        {
+            static std::vector <uint32_t> spirv;
+            static ncnn::Mutex lock;
+            {
+                ncnn::MutexLockGuard guard(lock);
+                if (spirv.empty()) {
+                    compile_spirv_module(srmd_rgb2yuv_comp_data, sizeof(srmd_rgb2yuv_comp_data), net.opt, spirv);
+                }
+            }
+
+            srmd_rgb2yuv = new ncnn::Pipeline(vkdev);
+            srmd_rgb2yuv->set_optimal_local_size_xyz(8, 8, 1);
+            srmd_rgb2yuv->create(spirv.data(), spirv.size() * 4, specializations);
+        }
     }
 
     // bicubic 2x/3x/4x for alpha channel
@@ -166,7 +242,7 @@ int SRMD::load(const std::string &parampath, const std::string &modelpath)
     return 0;
 }
 
-int SRMD::process(const ncnn::Mat &inimage, ncnn::Mat &outimage) const {
+int SRMD::process(const ncnn::Mat &inimage, ncnn::Mat &outimage, int format) const {
     if (!vkdev) {
         // cpu is not supported
         fprintf(stderr, "SRMD: cpu is not supported\n");
@@ -174,14 +250,28 @@ int SRMD::process(const ncnn::Mat &inimage, ncnn::Mat &outimage) const {
         return -1;
     }
 
+    const bool yuv = format == SRMD_FORMAT_I420 || format == SRMD_FORMAT_NV12;
+
+    if (format != SRMD_FORMAT_RGB && !yuv) {
+        fprintf(stderr, "SRMD: unknown format %d\n", format);
+
+        return -1;
+    }
+
+    if (yuv && (inimage.w % 2 != 0 || inimage.h % 2 != 0)) {
+        fprintf(stderr, "SRMD: yuv 4:2:0 requires even width and height\n");
+
+        return -1;
+    }
 
     const unsigned char *pixeldata = (const unsigned char *) inimage.data;
     const int w = inimage.w;
     const int h = inimage.h;
-    const int channels = inimage.elempack;
+    const int channels = yuv ? 3 : inimage.elempack;
 
-    const int TILE_SIZE_X = tilesize;
-    const int TILE_SIZE_Y = tilesize;
+    // yuv 4:2:0 row bands must start on a chroma row
+    const int TILE_SIZE_X = yuv ? tilesize / 2 * 2 : tilesize;
+    const int TILE_SIZE_Y = yuv ? tilesize / 2 * 2 : tilesize;
 
     ncnn::VkAllocator *blob_vkallocator = vkdev->acquire_blob_allocator();
     ncnn::VkAllocator *staging_vkallocator = vkdev->acquire_staging_allocator();
@@ -204,8 +294,27 @@ int SRMD::process(const ncnn::Mat &inimage, ncnn::Mat &outimage) const {
         int in_tile_y0 = std::max(yi * TILE_SIZE_Y - prepadding, 0);
         int in_tile_y1 = std::min((yi + 1) * TILE_SIZE_Y + prepadding, h);
 
+        if (yuv) {
+            in_tile_y0 = in_tile_y0 / 2 * 2;
+            in_tile_y1 = std::min((in_tile_y1 + 1) / 2 * 2, h);
+        }
+
         ncnn::Mat in;
-        if (opt.use_fp16_storage && opt.use_int8_storage) {
+        if (yuv) {
+            const int band_size = w * (in_tile_y1 - in_tile_y0) * 3 / 2;
+
+            ncnn::Mat band(band_size, (size_t) 1u);
+            yuv_band_from_frame(pixeldata, w, h, in_tile_y0, in_tile_y1, format, (unsigned char *) band.data);
+
+            if (opt.use_fp16_storage && opt.use_int8_storage) {
+                in = band;
+            } else {
+                in.create(band_size, (size_t) 4u);
+                for (int i = 0; i < band_size; i++) {
+                    in[i] = ((const unsigned char *) band.data)[i];
+                }
+            }
+        } else if (opt.use_fp16_storage && opt.use_int8_storage) {
             in = ncnn::Mat(w, (in_tile_y1 - in_tile_y0), (unsigned char *) pixeldata + in_tile_y0 * w * channels,
                            (size_t) channels, 1);
         } else {
@@ -224,7 +333,36 @@ int SRMD::process(const ncnn::Mat &inimage, ncnn::Mat &outimage) const {
         // upload
         ncnn::VkMat in_gpu;
         {
-            cmd.record_clone(in, in_gpu, opt);
+            if (yuv) {
+                ncnn::VkMat in_yuv_gpu;
+                cmd.record_clone(in, in_yuv_gpu, opt);
+
+                // convert to the layout preproc reads
+                if (opt.use_fp16_storage && opt.use_int8_storage) {
+                    in_gpu.create(w, in_tile_y1 - in_tile_y0, (size_t) channels, 1, blob_vkallocator);
+                } else {
+                    in_gpu.create(w, in_tile_y1 - in_tile_y0, channels, (size_t) 4u, 1, blob_vkallocator);
+                }
+
+                std::vector <ncnn::VkMat> bindings(2);
+                bindings[0] = in_yuv_gpu;
+                bindings[1] = in_gpu;
+
+                std::vector <ncnn::vk_constant_type> constants(4);
+                constants[0].i = in_gpu.w;
+                constants[1].i = in_gpu.h;
+                constants[2].i = in_gpu.cstep;
+                constants[3].i = format;
+
+                ncnn::VkMat dispatcher;
+                dispatcher.w = in_gpu.w;
+                dispatcher.h = in_gpu.h;
+                dispatcher.c = 1;
+
+                cmd.record_pipeline(srmd_yuv2rgb, bindings, constants, dispatcher);
+            } else {
+                cmd.record_clone(in, in_gpu, opt);
+            }
 
             if (xtiles > 1) {
                 cmd.submit_and_wait();
@@ -300,7 +438,7 @@ int SRMD::process(const ncnn::Mat &inimage, ncnn::Mat &outimage) const {
                     constants[6].i = prepadding;
                     constants[7].i = prepadding;
                     constants[8].i = xi * TILE_SIZE_X;
-                    constants[9].i = std::min(yi * TILE_SIZE_Y, prepadding);
+                    constants[9].i = yi * TILE_SIZE_Y - in_tile_y0;
                     constants[10].i = noise;
                     constants[11].i = channels;//(noise == -1 ? 18 : 19) + channels - 3;
                     constants[12].i = in_alpha_tile_gpu.w;
@@ -414,7 +552,7 @@ int SRMD::process(const ncnn::Mat &inimage, ncnn::Mat &outimage) const {
                     constants[6].i = prepadding;
                     constants[7].i = prepadding;
                     constants[8].i = xi * TILE_SIZE_X;
-                    constants[9].i = std::min(yi * TILE_SIZE_Y, prepadding);
+                    constants[9].i = yi * TILE_SIZE_Y - in_tile_y0;
                     constants[10].i = noise;
                     constants[11].i = channels;//(noise == -1 ? 18 : 19) + channels - 3;
                     constants[12].i = in_alpha_tile_gpu.w;
@@ -496,7 +634,51 @@ int SRMD::process(const ncnn::Mat &inimage, ncnn::Mat &outimage) const {
         }
 
         // download
-        {
+        if (yuv) {
+            ncnn::VkMat out_yuv_gpu;
+            out_yuv_gpu.create(out_gpu.w * out_gpu.h * 3 / 2,
+                               opt.use_fp16_storage && opt.use_int8_storage ? (size_t) 1u : (size_t) 4u, 1,
+                               blob_vkallocator);
+
+            {
+                std::vector <ncnn::VkMat> bindings(2);
+                bindings[0] = out_gpu;
+                bindings[1] = out_yuv_gpu;
+
+                std::vector <ncnn::vk_constant_type> constants(4);
+                constants[0].i = out_gpu.w;
+                constants[1].i = out_gpu.h;
+                constants[2].i = out_gpu.cstep;
+                constants[3].i = format;
+
+                // one invocation per 2x2 block
+                ncnn::VkMat dispatcher;
+                dispatcher.w = out_gpu.w / 2;
+                dispatcher.h = out_gpu.h / 2;
+                dispatcher.c = 1;
+
+                cmd.record_pipeline(srmd_rgb2yuv, bindings, constants, dispatcher);
+            }
+
+            ncnn::Mat out;
+
+            cmd.record_clone(out_yuv_gpu, out, opt);
+
+            cmd.submit_and_wait();
+
+            ncnn::Mat band;
+            if (opt.use_fp16_storage && opt.use_int8_storage) {
+                band = out;
+            } else {
+                band.create(out.w, (size_t) 1u);
+                for (int i = 0; i < out.w; i++) {
+                    ((unsigned char *) band.data)[i] = (unsigned char) out[i];
+                }
+            }
+
+            yuv_band_to_frame((const unsigned char *) band.data, w * scale, h * scale, out_tile_y0 * scale,
+                              out_tile_y1 * scale, format, (unsigned char *) outimage.data);
+        } else {
             ncnn::Mat out;
 
             if (opt.use_fp16_storage && opt.use_int8_storage) {
@@ -10,6 +10,13 @@
 #include "gpu.h"
 #include "layer.h"
 
+// frame layouts accepted by SRMD::process
+enum {
+    SRMD_FORMAT_RGB = 0,  // packed RGB/RGBA, channels taken from elempack
+    SRMD_FORMAT_I420 = 1, // planar Y, U, V 4:2:0, bt.601 limited range, left-sited chroma
+    SRMD_FORMAT_NV12 = 2, // planar Y, interleaved UV 4:2:0, bt.601 limited range, left-sited chroma
+};
+
 class SRMD {
 public:
     SRMD(int gpuid, bool tta_mode = false);
@@ -24,7 +31,8 @@ public:
 
 #endif
 
-    int process(const ncnn::Mat &inimage, ncnn::Mat &outimage) const;
+    // for yuv formats inimage and outimage are w x h Mats of 1 byte elements pointing at a whole frame
+    int process(const ncnn::Mat &inimage, ncnn::Mat &outimage, int format = SRMD_FORMAT_RGB) const;
 
 public:
     // srmd parameters
@@ -38,6 +46,8 @@ private:
     ncnn::Net net;
     ncnn::Pipeline *srmd_preproc;
     ncnn::Pipeline *srmd_postproc;
+    ncnn::Pipeline *srmd_yuv2rgb;
+    ncnn::Pipeline *srmd_rgb2yuv;
     ncnn::Layer *bicubic_2x;
     ncnn::Layer *bicubic_3x;
     ncnn::Layer *bicubic_4x;
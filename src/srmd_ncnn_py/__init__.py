@@ -1,3 +1,5 @@
+from .client import SRMDClient
+from .server import SRMDServer
 from .srmd_ncnn_vulkan import SRMD
 
-__all__ = ["SRMD"]
+__all__ = ["SRMD", "SRMDClient", "SRMDServer"]
@@ -0,0 +1,120 @@
+"""
+Thin client of SRMDServer, a drop-in replacement for SRMD.process_bytes that shares the server's models and gpu.
+"""
+
+import socket
+from multiprocessing import shared_memory
+from types import TracebackType
+from typing import Optional, Type
+
+try:
+    from .protocol import DEFAULT_SOCKET_PATH, recv_message, send_message
+except ImportError:
+    from protocol import DEFAULT_SOCKET_PATH, recv_message, send_message
+
+
+class SRMDClient:
+    def __init__(
+        self,
+        socket_path: str = DEFAULT_SOCKET_PATH,
+        tta_mode: bool = False,
+        noise: int = 3,
+        scale: int = 2,
+    ):
+        """
+        Client of a local SRMD server
+
+        :param socket_path: unix socket path the server listens on
+        :param tta_mode: enable test time argumentation
+        :param noise: denoise level, [-1, 10], default: 3
+        :param scale: upscale ratio, 2 or 3 or 4
+        """
+
+        assert noise in range(-1, 11), "noise must be [-1, 10]"
+        assert scale in range(2, 5), "scale must be 2 or 3 or 4"
+
+        self._tta_mode = tta_mode
+        self._noise = noise
+        self._scale = scale
+
+        self._sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self._sock.connect(socket_path)
+
+        # frame buffers, grown on demand and reused across frames
+        self._shm_in: Optional[shared_memory.SharedMemory] = None
+        self._shm_out: Optional[shared_memory.SharedMemory] = None
+
+    def process_bytes(self, _image_bytes: bytes, width: int, height: int, channels: int) -> bytes:
+        """
+        Process a bytes image, like bytes from ffmpeg
+
+        :param _image_bytes: bytes
+        :param width: image width
+        :param height: image height
+        :param channels: image channels
+        :return: processed bytes image
+        """
+        in_size = len(_image_bytes)
+        out_size = (self._scale**2) * in_size
+
+        if self._shm_in is None or self._shm_in.size < in_size:
+            self._shm_in = self._recreate_shm(self._shm_in, in_size)
+        if self._shm_out is None or self._shm_out.size < out_size:
+            self._shm_out = self._recreate_shm(self._shm_out, out_size)
+
+        self._shm_in.buf[:in_size] = _image_bytes
+
+        send_message(
+            self._sock,
+            {
+                "op": "process",
+                "shm_in": self._shm_in.name,
+                "shm_out": self._shm_out.name,
+                "width": width,
+                "height": height,
+                "channels": channels,
+                "noise": self._noise,
+                "scale": self._scale,
+                "tta_mode": self._tta_mode,
+            },
+        )
+
+        response = recv_message(self._sock)
+        if response is None:
+            raise Exception("SRMD server closed the connection")
+        if not response["ok"]:
+            raise Exception(f"SRMD server failed to process image: {response['error']}")
+
+        return bytes(self._shm_out.buf[:out_size])
+
+    def close(self) -> None:
+        """
+        Disconnect from the server and free the frame buffers
+
+        :return: None
+        """
+        self._sock.close()
+        for shm in (self._shm_in, self._shm_out):
+            if shm is not None:
+                shm.close()
+                shm.unlink()
+        self._shm_in = None
+        self._shm_out = None
+
+    def __enter__(self) -> "SRMDClient":
+        return self
+
+    def __exit__(
+        self,
+        exc_type: Optional[Type[BaseException]],
+        exc_val: Optional[BaseException],
+        exc_tb: Optional[TracebackType],
+    ) -> None:
+        self.close()
+
+    @staticmethod
+    def _recreate_shm(shm: Optional[shared_memory.SharedMemory], size: int) -> shared_memory.SharedMemory:
+        if shm is not None:
+            shm.close()
+            shm.unlink()
+        return shared_memory.SharedMemory(create=True, size=size)
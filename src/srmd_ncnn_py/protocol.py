@@ -0,0 +1,75 @@
+"""
+Wire protocol shared by SRMDServer and SRMDClient.
+
+Every message is a 4-byte big-endian length followed by a UTF-8 JSON object. Frame data never goes through the
+socket, it is exchanged in POSIX shared memory blocks owned by the client:
+
+request:  {"op": "process", "shm_in": str, "shm_out": str, "width": int, "height": int, "channels": int,
+           "noise": int, "scale": int, "tta_mode": bool}
+response: {"ok": true} or {"ok": false, "error": str}
+"""
+
+import json
+import os
+import socket
+import struct
+import tempfile
+from multiprocessing import resource_tracker, shared_memory
+from typing import Any, Dict, Optional
+
+DEFAULT_SOCKET_PATH = os.path.join(tempfile.gettempdir(), "srmd-ncnn-py.sock")
+
+_HEADER = struct.Struct("!I")
+
+
+def send_message(sock: socket.socket, message: Dict[str, Any]) -> None:
+    """
+    Send a length-prefixed JSON message
+
+    :param sock: connected unix socket
+    :param message: JSON serializable dict
+    :return: None
+    """
+    payload = json.dumps(message).encode("utf-8")
+    sock.sendall(_HEADER.pack(len(payload)) + payload)
+
+
+def recv_message(sock: socket.socket) -> Optional[Dict[str, Any]]:
+    """
+    Receive a length-prefixed JSON message
+
+    :param sock: connected unix socket
+    :return: the message, None if the peer closed the connection
+    """
+    header = _recv_exactly(sock, _HEADER.size)
+    if header is None:
+        return None
+
+    payload = _recv_exactly(sock, _HEADER.unpack(header)[0])
+    if payload is None:
+        return None
+
+    return json.loads(payload.decode("utf-8"))
+
+
+def attach_shm(name: str) -> shared_memory.SharedMemory:
+    """
+    Attach to a shared memory block created by another process, without letting this process' resource tracker
+    unlink it on exit
+
+    :param name: shared memory block name
+    :return: SharedMemory
+    """
+    shm = shared_memory.SharedMemory(name=name)
+    resource_tracker.unregister(shm._name, "shared_memory")
+    return shm
+
+
+def _recv_exactly(sock: socket.socket, size: int) -> Optional[bytes]:
+    buf = bytearray()
+    while len(buf) < size:
+        chunk = sock.recv(size - len(buf))
+        if not chunk:
+            return None
+        buf += chunk
+    return bytes(buf)
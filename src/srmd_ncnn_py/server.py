@@ -0,0 +1,377 @@
+"""
+Local upscaling daemon.
+
+One process owns the Vulkan instance and the loaded models, worker processes talk to it through a unix socket and
+exchange frames in POSIX shared memory (see protocol.py). All GPU work runs on a single scheduler thread, which
+serves clients round-robin. Loaded models are kept in a small LRU, the scheduler groups the compatible (same
+noise/scale/tta_mode) head requests of several clients so they run back to back on one model instance instead of
+making it reload between them.
+
+Run it with: python -m srmd_ncnn_py.server --socket /tmp/srmd-ncnn-py.sock --gpuid 0
+"""
+
+import argparse
+import os
+import socket
+import stat
+import threading
+from collections import OrderedDict, deque
+from multiprocessing import shared_memory
+from typing import Any, Deque, Dict, List, Optional, Tuple
+
+try:
+    from .protocol import DEFAULT_SOCKET_PATH, attach_shm, recv_message, send_message
+    from .srmd_ncnn_vulkan import SRMD
+except ImportError:
+    from protocol import DEFAULT_SOCKET_PATH, attach_shm, recv_message, send_message
+    from srmd_ncnn_vulkan import SRMD
+
+# (noise, scale, tta_mode)
+ModelKey = Tuple[int, int, bool]
+
+# max input width / height accepted from a client
+MAX_FRAME_SIZE = 16384
+
+
+class _Job:
+    def __init__(
+        self,
+        client_id: int,
+        key: ModelKey,
+        shm_in: shared_memory.SharedMemory,
+        shm_out: shared_memory.SharedMemory,
+        width: int,
+        height: int,
+        channels: int,
+    ):
+        self.client_id = client_id
+        self.key = key
+        self.shm_in = shm_in
+        self.shm_out = shm_out
+        self.width = width
+        self.height = height
+        self.channels = channels
+
+        self.done = threading.Event()
+        self.error: Optional[str] = None
+
+
+class SRMDServer:
+    def __init__(
+        self,
+        socket_path: str = DEFAULT_SOCKET_PATH,
+        gpuid: int = 0,
+        tilesize: int = 0,
+        model: str = "models-srmd",
+        max_batch: int = 8,
+        max_models: int = 2,
+    ):
+        """
+        SRMD upscaling server, shares model instances and the gpu between local clients
+
+        :param socket_path: path of the unix socket to listen on
+        :param gpuid: gpu device to use, must >= 0, cpu is not supported
+        :param tilesize: tile size, 0 for auto, must >= 32
+        :param model: SRMD model name, can be "models-srmd" or an absolute path to a model folder
+        :param max_batch: max number of requests run back to back on one model instance, at most one per client
+        :param max_models: max number of loaded models, the least recently used one is unloaded first
+        """
+
+        assert gpuid >= 0, "gpuid must >= 0, cpu is not supported"
+        assert tilesize == 0 or tilesize >= 32, "tilesize must >= 32 or be 0"
+        assert max_batch >= 1, "max_batch must >= 1"
+        assert max_models >= 1, "max_models must >= 1"
+
+        self._socket_path = socket_path
+        self._gpuid = gpuid
+        self._tilesize = tilesize
+        self._model = model
+        self._max_batch = max_batch
+        self._max_models = max_models
+
+        # LRU of loaded models, only touched by the scheduler thread
+        self._models: "OrderedDict[ModelKey, SRMD]" = OrderedDict()
+
+        # per-client pending jobs, in round-robin order
+        self._queues: "OrderedDict[int, Deque[_Job]]" = OrderedDict()
+        self._cond = threading.Condition()
+        self._next_client_id = 0
+        self._closed = False
+
+        self._listener: Optional[socket.socket] = None
+
+    def serve_forever(self) -> None:
+        """
+        Listen on the unix socket and serve clients until shutdown() is called
+
+        :return: None
+        """
+        self._remove_stale_socket()
+
+        self._listener = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+
+        # clients can make the server write into any shared memory block they name, so only the owner may connect
+        old_umask = os.umask(0o177)
+        try:
+            self._listener.bind(self._socket_path)
+        finally:
+            os.umask(old_umask)
+        os.chmod(self._socket_path, 0o600)
+
+        self._listener.listen()
+
+        scheduler = threading.Thread(target=self._schedule, daemon=True)
+        scheduler.start()
+
+        try:
+            while not self._closed:
+                try:
+                    conn, _ = self._listener.accept()
+                except OSError:
+                    break
+                threading.Thread(target=self._handle_client, args=(conn,), daemon=True).start()
+        finally:
+            self.shutdown()
+            scheduler.join()
+            if os.path.exists(self._socket_path):
+                os.unlink(self._socket_path)
+
+    def _remove_stale_socket(self) -> None:
+        """
+        Remove the socket left behind by a dead server, refuse to take over the socket of a live one
+
+        :return: None
+        """
+        try:
+            mode = os.lstat(self._socket_path).st_mode
+        except FileNotFoundError:
+            return
+
+        if not stat.S_ISSOCK(mode):
+            raise RuntimeError(f"{self._socket_path} exists and is not a socket")
+
+        probe = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        try:
+            probe.connect(self._socket_path)
+        except ConnectionRefusedError:
+            os.unlink(self._socket_path)
+            return
+        finally:
+            probe.close()
+
+        raise RuntimeError(f"another SRMD server is listening on {self._socket_path}")
+
+    def shutdown(self) -> None:
+        """
+        Stop accepting clients and stop the scheduler, pending requests fail
+
+        :return: None
+        """
+        with self._cond:
+            self._closed = True
+            self._cond.notify_all()
+
+        if self._listener is not None:
+            try:
+                self._listener.shutdown(socket.SHUT_RDWR)
+            except OSError:
+                pass
+            self._listener.close()
+
+    def _handle_client(self, conn: socket.socket) -> None:
+        with self._cond:
+            client_id = self._next_client_id
+            self._next_client_id += 1
+            self._queues[client_id] = deque()
+
+        # clients reuse their buffers across frames, keep them attached
+        attached: Dict[str, shared_memory.SharedMemory] = {}
+
+        try:
+            while True:
+                try:
+                    request = recv_message(conn)
+                except ValueError as e:
+                    # the length prefix was consumed, so the stream is still in sync
+                    send_message(conn, {"ok": False, "error": f"malformed message: {e}"})
+                    continue
+
+                if request is None:
+                    break
+
+                try:
+                    job = self._make_job(client_id, request, attached)
+                except Exception as e:
+                    send_message(conn, {"ok": False, "error": str(e)})
+                    continue
+
+                with self._cond:
+                    if self._closed:
+                        job.error = "SRMD server is shutting down"
+                        job.done.set()
+                    else:
+                        self._queues[client_id].append(job)
+                        self._cond.notify_all()
+
+                job.done.wait()
+
+                if job.error is None:
+                    send_message(conn, {"ok": True})
+                else:
+                    send_message(conn, {"ok": False, "error": job.error})
+        except (OSError, ValueError):
+            pass
+        finally:
+            with self._cond:
+                del self._queues[client_id]
+            conn.close()
+            for shm in attached.values():
+                shm.close()
+
+    def _make_job(
+        self, client_id: int, request: Dict[str, Any], attached: Dict[str, shared_memory.SharedMemory]
+    ) -> _Job:
+        if request.get("op") != "process":
+            raise ValueError(f"unknown op: {request.get('op')}")
+
+        width = int(request["width"])
+        height = int(request["height"])
+        channels = int(request["channels"])
+        noise = int(request["noise"])
+        scale = int(request["scale"])
+        tta_mode = bool(request["tta_mode"])
+
+        if noise not in range(-1, 11):
+            raise ValueError("noise must be [-1, 10]")
+        if scale not in range(2, 5):
+            raise ValueError("scale must be 2 or 3 or 4")
+        if channels not in (3, 4):
+            raise ValueError("channels must be 3 or 4")
+        if not (0 < width <= MAX_FRAME_SIZE and 0 < height <= MAX_FRAME_SIZE):
+            raise ValueError(f"width and height must be (0, {MAX_FRAME_SIZE}]")
+
+        # the native band loop would overwrite input rows that later bands still read
+        if request["shm_in"] == request["shm_out"]:
+            raise ValueError("shm_in and shm_out must be different shared memory blocks")
+
+        # a client only has one input and one output buffer, drop the ones it has replaced
+        names = (request["shm_in"], request["shm_out"])
+        for name in [name for name in attached if name not in names]:
+            attached.pop(name).close()
+        for name in names:
+            if name not in attached:
+                attached[name] = attach_shm(name)
+
+        shm_in = attached[request["shm_in"]]
+        shm_out = attached[request["shm_out"]]
+
+        in_size = width * height * channels
+        if shm_in.size < in_size or shm_out.size < (scale**2) * in_size:
+            raise ValueError("shared memory is too small for the frame")
+
+        return _Job(client_id, (noise, scale, tta_mode), shm_in, shm_out, width, height, channels)
+
+    def _next_batch(self) -> List[_Job]:
+        """
+        Wait for pending jobs, then take the head job of the first client in round-robin order plus the compatible
+        head jobs of the following clients. Served clients move to the back of the order.
+
+        :return: jobs sharing the same model key, empty if the server is closed
+        """
+        with self._cond:
+            while not self._closed and not any(self._queues.values()):
+                self._cond.wait()
+
+            if self._closed:
+                for queue in self._queues.values():
+                    for job in queue:
+                        job.error = "SRMD server is shutting down"
+                        job.done.set()
+                    queue.clear()
+                return []
+
+            batch: List[_Job] = []
+            for client_id, queue in list(self._queues.items()):
+                if not queue or (batch and queue[0].key != batch[0].key):
+                    continue
+
+                batch.append(queue.popleft())
+                self._queues.move_to_end(client_id)
+
+                if len(batch) >= self._max_batch:
+                    break
+
+            return batch
+
+    def _schedule(self) -> None:
+        while True:
+            batch = self._next_batch()
+            if not batch:
+                return
+
+            try:
+                srmd = self._get_model(batch[0].key)
+            except Exception as e:
+                for job in batch:
+                    job.error = str(e)
+                    job.done.set()
+                continue
+
+            for job in batch:
+                try:
+                    self._process(srmd, job)
+                except Exception as e:
+                    job.error = str(e)
+                job.done.set()
+
+    def _get_model(self, key: ModelKey) -> SRMD:
+        if key in self._models:
+            self._models.move_to_end(key)
+            return self._models[key]
+
+        while len(self._models) >= self._max_models:
+            self._models.popitem(last=False)
+
+        noise, scale, tta_mode = key
+        self._models[key] = SRMD(
+            gpuid=self._gpuid,
+            tta_mode=tta_mode,
+            noise=noise,
+            scale=scale,
+            tilesize=self._tilesize,
+            model=self._model,
+        )
+        return self._models[key]
+
+    @staticmethod
+    def _process(srmd: SRMD, job: _Job) -> None:
+        # read and write the shared memory directly
+        srmd.process_buffer(job.shm_in.buf, job.shm_out.buf, job.width, job.height, job.channels)
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(description="srmd-ncnn-py upscaling server")
+    parser.add_argument("--socket", default=DEFAULT_SOCKET_PATH, help="unix socket path")
+    parser.add_argument("--gpuid", type=int, default=0, help="gpu device to use")
+    parser.add_argument("--tilesize", type=int, default=0, help="tile size, 0 for auto")
+    parser.add_argument("--model", default="models-srmd", help="model name or path to a model folder")
+    parser.add_argument("--max-batch", type=int, default=8, help="max requests per batch")
+    parser.add_argument("--max-models", type=int, default=2, help="max number of loaded models")
+    args = parser.parse_args()
+
+    server = SRMDServer(
+        socket_path=args.socket,
+        gpuid=args.gpuid,
+        tilesize=args.tilesize,
+        model=args.model,
+        max_batch=args.max_batch,
+        max_models=args.max_models,
+    )
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        server.shutdown()
+
+
+if __name__ == "__main__":
+    main()
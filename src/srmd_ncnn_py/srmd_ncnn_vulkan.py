@@ -24,7 +24,8 @@ SOFTWARE.
 # 参考https://github.com/media2x/srmd-ncnn-vulkan-python, 感谢原作者
 
 import pathlib
-from typing import Optional
+from collections import OrderedDict
+from typing import Hashable, Optional, Tuple
 
 import cv2
 import numpy as np
@@ -35,6 +36,12 @@ try:
 except ImportError:
     import srmd_ncnn_vulkan_wrapper as wrapped
 
+# ffmpeg pix_fmt -> SRMDImage format
+YUV_FORMATS = {
+    "yuv420p": wrapped.FORMAT_I420,
+    "nv12": wrapped.FORMAT_NV12,
+}
+
 
 class SRMD:
     def __init__(
@@ -45,6 +52,7 @@ class SRMD:
         scale: int = 2,
         tilesize: int = 0,
         model: str = "models-srmd",
+        roi_cache_size: int = 64,
     ):
         """
         SRMD class for Super-Resolution
@@ -55,6 +63,8 @@ class SRMD:
         :param scale: upscale ratio, 2 or 3 or 4
         :param tilesize: tile size, 0 for auto, must >= 32
         :param model: SRMD model name, can be "models-srmd" or an absolute path to a model folder
+        :param roi_cache_size: max number of upscaled tiles kept for process_roi_bytes, 0 to disable, default: 64,
+            grown to the tile count of the current roi when that is larger
         """
 
         # check arguments' validity
@@ -62,6 +72,7 @@ class SRMD:
         assert noise in range(-1, 11), "noise must be [-1, 10]"
         assert scale in range(2, 5), "scale must be 2 or 3 or 4"
         assert tilesize == 0 or tilesize >= 32, "tilesize must >= 32 or be 0"
+        assert roi_cache_size >= 0, "roi_cache_size must >= 0"
 
         self._gpuid = gpuid
 
@@ -71,6 +82,11 @@ class SRMD:
         self._noise = noise
         self._scale = scale
         self._tilesize = tilesize
+        self._prepadding = 12
+
+        # LRU cache of upscaled tiles, keyed by (image id, tile x, tile y, noise, scale)
+        self._roi_cache: "OrderedDict[Tuple[Hashable, int, int, int, int], np.ndarray]" = OrderedDict()
+        self._roi_cache_size = roi_cache_size
 
         self.set_parameters()
 
@@ -78,6 +94,9 @@ class SRMD:
 
         self.raw_in_image = None
         self.raw_out_image = None
+        self.raw_in_yuv_image = None
+        self.raw_out_yuv_image = None
+        self._yuv_frame: Optional[Tuple[int, int, str]] = None
 
     def set_parameters(self, prepadding: int = 12) -> None:
         """
@@ -87,6 +106,9 @@ class SRMD:
         :return: None
         """
 
+        self._prepadding = prepadding
+        self._roi_cache.clear()
+
         self._srmd_object.set_parameters(self._noise, self._scale, prepadding, self._tilesize)
 
     def _load(self, param_path: Optional[pathlib.Path] = None, model_path: Optional[pathlib.Path] = None) -> None:
@@ -202,3 +224,196 @@ class SRMD:
         self.process()
 
         return self.raw_out_image.get_data()
+
+    def process_buffer(
+        self, in_buffer: memoryview, out_buffer: memoryview, width: int, height: int, channels: int
+    ) -> None:
+        """
+        Process a packed RGB/RGBA image in place between two buffers, like shared memory, without copying the frames
+
+        :param in_buffer: contiguous buffer holding width * height * channels bytes
+        :param out_buffer: writable contiguous buffer of at least scale ** 2 * width * height * channels bytes
+        :param width: image width
+        :param height: image height
+        :param channels: image channels
+        :return: None
+        """
+        if self._srmd_object.process_buffer(in_buffer, out_buffer, width, height, channels) != 0:
+            raise Exception("Failed to process image")
+
+    def process_yuv_bytes(self, _image_bytes: bytes, width: int, height: int, pix_fmt: str = "yuv420p") -> bytes:
+        """
+        Process a yuv 4:2:0 bytes image, like bytes from ffmpeg with -pix_fmt yuv420p or nv12.
+        The colourspace conversion runs on the gpu, the output has the same pix_fmt. bt.601 limited range and left-sited
+        chroma (ffmpeg's default for mpeg-2/h.264/hevc) are assumed.
+
+        :param _image_bytes: bytes
+        :param width: image width, must be even
+        :param height: image height, must be even
+        :param pix_fmt: "yuv420p" (I420) or "nv12"
+        :return: processed bytes image
+        """
+        assert pix_fmt in YUV_FORMATS, "pix_fmt must be yuv420p or nv12"
+        assert width > 0 and height > 0, "width and height must > 0"
+        assert width % 2 == 0 and height % 2 == 0, "width and height must be even"
+        assert len(_image_bytes) == width * height * 3 // 2, "image bytes must be width * height * 3 / 2"
+
+        _format = YUV_FORMATS[pix_fmt]
+
+        if self._yuv_frame != (width, height, pix_fmt):
+            self._yuv_frame = (width, height, pix_fmt)
+
+            self.raw_in_yuv_image = wrapped.SRMDImage(_image_bytes, width, height, 3, _format)
+
+            self.raw_out_yuv_image = wrapped.SRMDImage(
+                (self._scale**2) * len(_image_bytes) * b"\x00",
+                self._scale * width,
+                self._scale * height,
+                3,
+                _format,
+            )
+
+        self.raw_in_yuv_image.set_data(_image_bytes)
+
+        if self._srmd_object.process(self.raw_in_yuv_image, self.raw_out_yuv_image) != 0:
+            raise Exception("Failed to process image")
+
+        return self.raw_out_yuv_image.get_data()
+
+    def process_roi_bytes(
+        self,
+        _image_bytes: bytes,
+        width: int,
+        height: int,
+        channels: int,
+        roi: Tuple[int, int, int, int],
+        image_id: Hashable,
+    ) -> bytes:
+        """
+        Process only the part of a bytes image needed to cover an output-space rectangle, like a viewer's viewport.
+        The image is split into tiles, each tile is upscaled with its prepadding halo and cached, so panning only
+        costs the newly exposed tiles.
+
+        :param _image_bytes: bytes
+        :param width: image width
+        :param height: image height
+        :param channels: image channels
+        :param roi: (x, y, w, h) rectangle in output space, clipped to the upscaled image
+        :param image_id: identifies the image in the tile cache, must change when the image content changes
+        :return: processed bytes of the clipped rectangle
+        """
+        out_w = self._scale * width
+        out_h = self._scale * height
+
+        roi_x0 = max(roi[0], 0)
+        roi_y0 = max(roi[1], 0)
+        roi_x1 = min(roi[0] + roi[2], out_w)
+        roi_y1 = min(roi[1] + roi[3], out_h)
+        assert roi_x1 > roi_x0 and roi_y1 > roi_y0, "roi must overlap the output image"
+
+        src = np.frombuffer(_image_bytes, dtype=np.uint8).reshape(height, width, channels)
+        res = np.empty((roi_y1 - roi_y0, roi_x1 - roi_x0, channels), dtype=np.uint8)
+
+        tile_out = self._roi_tilesize() * self._scale
+
+        # tiles of this roi, only inserted into the cache once the result is built so none of them gets evicted
+        # before it is used
+        tiles: "OrderedDict[Tuple[Hashable, int, int, int, int], np.ndarray]" = OrderedDict()
+
+        for ty in range(roi_y0 // tile_out, (roi_y1 - 1) // tile_out + 1):
+            for tx in range(roi_x0 // tile_out, (roi_x1 - 1) // tile_out + 1):
+                key = (image_id, tx, ty, self._noise, self._scale)
+
+                tile = self._roi_cache.get(key)
+                if tile is None:
+                    tile = self._upscale_roi_tile(src, tx, ty)
+                tiles[key] = tile
+
+                # intersect the tile with the roi, both in output space
+                x0 = max(tx * tile_out, roi_x0)
+                y0 = max(ty * tile_out, roi_y0)
+                x1 = min(tx * tile_out + tile.shape[1], roi_x1)
+                y1 = min(ty * tile_out + tile.shape[0], roi_y1)
+
+                res[y0 - roi_y0 : y1 - roi_y0, x0 - roi_x0 : x1 - roi_x0] = tile[
+                    y0 - ty * tile_out : y1 - ty * tile_out, x0 - tx * tile_out : x1 - tx * tile_out
+                ]
+
+        if self._roi_cache_size > 0:
+            for key, tile in tiles.items():
+                self._roi_cache[key] = tile
+                self._roi_cache.move_to_end(key)
+            while len(self._roi_cache) > max(self._roi_cache_size, len(tiles)):
+                self._roi_cache.popitem(last=False)
+
+        return res.tobytes()
+
+    def clear_roi_cache(self, image_id: Optional[Hashable] = None) -> None:
+        """
+        Drop cached tiles of process_roi_bytes
+
+        :param image_id: only drop the tiles of this image, None for all images
+        :return: None
+        """
+        if image_id is None:
+            self._roi_cache.clear()
+            return
+
+        for key in [key for key in self._roi_cache if key[0] == image_id]:
+            del self._roi_cache[key]
+
+    def _roi_tilesize(self) -> int:
+        """
+        Size roi tiles so that a tile plus its halo is exactly one native tile and SRMD::process does not split it
+
+        :return: roi tile size in input space
+        """
+        native_tilesize = self._tilesize if self._tilesize else self._srmd_object.get_tilesize()
+        return max(native_tilesize - 2 * self._prepadding, 1)
+
+    def _upscale_roi_tile(self, src: np.ndarray, tx: int, ty: int) -> np.ndarray:
+        """
+        Upscale a tile with its halo
+
+        :param src: source image, shape (height, width, channels)
+        :param tx: tile column
+        :param ty: tile row
+        :return: upscaled tile without halo
+        """
+        height, width, channels = src.shape
+        tilesize = self._roi_tilesize()
+
+        x0 = tx * tilesize
+        y0 = ty * tilesize
+        x1 = min(x0 + tilesize, width)
+        y1 = min(y0 + tilesize, height)
+
+        # crop with halo, so the tile sees the same neighbourhood as in a full frame
+        halo_x0 = max(x0 - self._prepadding, 0)
+        halo_y0 = max(y0 - self._prepadding, 0)
+        halo_x1 = min(x1 + self._prepadding, width)
+        halo_y1 = min(y1 + self._prepadding, height)
+
+        in_bytes = src[halo_y0:halo_y1, halo_x0:halo_x1].tobytes()
+        halo_w = halo_x1 - halo_x0
+        halo_h = halo_y1 - halo_y0
+
+        in_image = wrapped.SRMDImage(in_bytes, halo_w, halo_h, channels)
+        out_image = wrapped.SRMDImage(
+            (self._scale**2) * len(in_bytes) * b"\x00",
+            self._scale * halo_w,
+            self._scale * halo_h,
+            channels,
+        )
+
+        # never hand a failed (all zero) tile to the cache
+        if self._srmd_object.process(in_image, out_image) != 0:
+            raise Exception("Failed to process image")
+
+        out = np.frombuffer(out_image.get_data(), dtype=np.uint8).reshape(
+            self._scale * halo_h, self._scale * halo_w, channels
+        )
+        return out[
+            self._scale * (y0 - halo_y0) : self._scale * (y1 - halo_y0),
+            self._scale * (x0 - halo_x0) : self._scale * (x1 - halo_x0),
+        ].copy()
@@ -1,11 +1,12 @@
 #include "srmd_wrapped.h"
 
 // Image Data Structure
-SRMDImage::SRMDImage(std::string d, int w, int h, int c) {
+SRMDImage::SRMDImage(std::string d, int w, int h, int c, int format) {
     this->d = std::move(d);
     this->w = w;
     this->h = h;
     this->c = c;
+    this->format = format;
 }
 
 void SRMDImage::set_data(std::string data) {
@@ -63,6 +64,32 @@ int SRMDWrapped::load(const std::string &parampath,
 }
 
 int SRMDWrapped::process(const SRMDImage &inimage, SRMDImage &outimage) const {
+    if (inimage.format != outimage.format) {
+        fprintf(stderr, "SRMD: input and output format mismatch\n");
+        return -1;
+    }
+
+    if (inimage.format != SRMD_FORMAT_RGB) {
+        if (inimage.w <= 0 || inimage.h <= 0 || outimage.w != inimage.w * SRMD::scale ||
+            outimage.h != inimage.h * SRMD::scale) {
+            fprintf(stderr, "SRMD: invalid image size\n");
+            return -1;
+        }
+
+        if (inimage.d.size() < (size_t) inimage.w * inimage.h * 3 / 2 ||
+            outimage.d.size() < (size_t) outimage.w * outimage.h * 3 / 2) {
+            fprintf(stderr, "SRMD: buffer is too small for the yuv frame\n");
+            return -1;
+        }
+
+        // whole yuv frame behind a w x h Mat of bytes
+        ncnn::Mat inimagemat =
+                ncnn::Mat(inimage.w, inimage.h, (void *) inimage.d.data(), (size_t) 1u, 1);
+        ncnn::Mat outimagemat =
+                ncnn::Mat(outimage.w, outimage.h, (void *) outimage.d.data(), (size_t) 1u, 1);
+        return SRMD::process(inimagemat, outimagemat, inimage.format);
+    }
+
     int c = inimage.c;
     ncnn::Mat inimagemat =
             ncnn::Mat(inimage.w, inimage.h, (void *) inimage.d.data(), (size_t) c, c);
@@ -71,6 +98,36 @@ int SRMDWrapped::process(const SRMDImage &inimage, SRMDImage &outimage) const {
     return SRMD::process(inimagemat, outimagemat);
 }
 
+int SRMDWrapped::process_buffer(const pybind11::buffer &inbuffer, const pybind11::buffer &outbuffer, int w, int h,
+                                int c) const {
+    if (w <= 0 || h <= 0 || (c != 3 && c != 4)) {
+        fprintf(stderr, "SRMD: invalid image size %dx%dx%d\n", w, h, c);
+        return -1;
+    }
+
+    pybind11::buffer_info in = inbuffer.request();
+    pybind11::buffer_info out = outbuffer.request(true);
+
+    const size_t in_size = (size_t) w * h * c;
+    const size_t out_size = in_size * SRMD::scale * SRMD::scale;
+
+    if (in.ndim != 1 || in.strides[0] != in.itemsize || out.ndim != 1 || out.strides[0] != out.itemsize) {
+        fprintf(stderr, "SRMD: buffers must be contiguous\n");
+        return -1;
+    }
+
+    if ((size_t) (in.size * in.itemsize) < in_size || (size_t) (out.size * out.itemsize) < out_size) {
+        fprintf(stderr, "SRMD: buffer is too small for the image\n");
+        return -1;
+    }
+
+    ncnn::Mat inimagemat = ncnn::Mat(w, h, in.ptr, (size_t) c, c);
+    ncnn::Mat outimagemat = ncnn::Mat(w * SRMD::scale, h * SRMD::scale, out.ptr, (size_t) c, c);
+
+    pybind11::gil_scoped_release release;
+    return SRMD::process(inimagemat, outimagemat);
+}
+
 int get_gpu_count() { return ncnn::get_gpu_count(); }
 
 void destroy_gpu_instance() { ncnn::destroy_gpu_instance(); }
@@ -80,13 +137,20 @@ PYBIND11_MODULE(srmd_ncnn_vulkan_wrapper, m) {
             .def(pybind11::init<int, bool>())
             .def("load", &SRMDWrapped::load)
             .def("process", &SRMDWrapped::process)
+            .def("process_buffer", &SRMDWrapped::process_buffer)
+            .def("get_tilesize", &SRMDWrapped::get_tilesize)
             .def("set_parameters", &SRMDWrapped::set_parameters);
 
     pybind11::class_<SRMDImage>(m, "SRMDImage")
             .def(pybind11::init<std::string, int, int, int>())
+            .def(pybind11::init<std::string, int, int, int, int>())
             .def("get_data", &SRMDImage::get_data)
             .def("set_data", &SRMDImage::set_data);
 
+    m.attr("FORMAT_RGB") = (int) SRMD_FORMAT_RGB;
+    m.attr("FORMAT_I420") = (int) SRMD_FORMAT_I420;
+    m.attr("FORMAT_NV12") = (int) SRMD_FORMAT_NV12;
+
     m.def("get_gpu_count", &get_gpu_count);
 
     m.def("destroy_gpu_instance", &destroy_gpu_instance);
@@ -15,8 +15,10 @@ public:
     int w;
     int h;
     int c;
+    // SRMD_FORMAT_RGB, SRMD_FORMAT_I420 or SRMD_FORMAT_NV12, c is ignored for yuv
+    int format;
 
-    SRMDImage(std::string d, int w, int h, int c);
+    SRMDImage(std::string d, int w, int h, int c, int format = SRMD_FORMAT_RGB);
 
     void set_data(std::string data);
 
@@ -36,6 +38,9 @@ public:
 
     int process(const SRMDImage &inimage, SRMDImage &outimage) const;
 
+    // process packed RGB/RGBA straight from/into python buffers (e.g. shared memory), without copies
+    int process_buffer(const pybind11::buffer &inbuffer, const pybind11::buffer &outbuffer, int w, int h, int c) const;
+
 private:
     int gpuid;
 };